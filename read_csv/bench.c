@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "dataframe.h"
+
+// reproducible csv loading benchmarks
+//
+// build: cc -O2 -o bench bench.c dataframe.c
+//
+//   ./bench generate <out.csv> [--rows N] [--cols N] [--width N] [--numeric P] [--quote P] [--cardinality N] [--seed N]
+//   ./bench run <file.csv> [--repeat N] [--label NAME]
+//   ./bench suite [dir] [--repeat N]
+//
+// run and suite print one json object per line to stdout so results can be diffed against a baseline run
+
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_WRITE_BUFFER (1 << 20) // 1MB
+
+
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t width;        // characters per generated value
+    double numeric;      // fraction of columns that hold numbers
+    double quote;        // fraction of string values that are quoted (with an embedded delimiter and "")
+    size_t cardinality;  // distinct values per string column, 0 means every value is random
+    uint64_t seed;
+} GenerateOptions;
+
+// the suite, every parser change should be measured against all of these
+typedef struct {
+    const char *name;
+    GenerateOptions options;
+} SuiteCase;
+
+static const SuiteCase SUITE[] = {
+    { "narrow_strings_lowcard", { 1000000, 4,  8,  0.0, 0.0, 16,  1 } },
+    { "wide_mixed",             { 200000,  32, 12, 0.5, 0.0, 100, 2 } },
+    { "numeric_only",           { 500000,  16, 10, 1.0, 0.0, 0,   3 } },
+    { "long_fields",            { 100000,  8,  96, 0.0, 0.0, 0,   4 } },
+    { "quoted_heavy",           { 500000,  8,  16, 0.2, 0.5, 0,   5 } },
+    { "highcard_strings",       { 500000,  8,  16, 0.0, 0.0, 0,   6 } },
+};
+
+
+// splitmix64, so the same seed produces the same file everywhere
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static double next_unit(uint64_t *state)
+{
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void random_word(uint64_t *state, char *out, size_t width)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    for(size_t i = 0; i < width; i++){
+        out[i] = alphabet[next_random(state) % (sizeof(alphabet) - 1)];
+    }
+    out[width] = '\0';
+}
+
+static int write_generated_csv(FILE *file, const GenerateOptions *options)
+{
+    uint64_t state = options->seed;
+    size_t width = options->width ? options->width : 1;
+
+    // decide up front which columns are numeric, and build the value pool for string columns
+    int *numeric = malloc(options->cols * sizeof(int));
+    char *pool = NULL;
+    char *word = malloc(width + 1);
+    if(numeric == NULL || word == NULL){
+        perror("Error allocating memory for generator");
+        free(numeric);
+        free(word);
+        return -1;
+    }
+    for(size_t col = 0; col < options->cols; col++){
+        numeric[col] = next_unit(&state) < options->numeric;
+    }
+    if(options->cardinality > 0){
+        pool = malloc(options->cardinality * (width + 1));
+        if(pool == NULL){
+            perror("Error allocating memory for value pool");
+            free(numeric);
+            free(word);
+            return -1;
+        }
+        for(size_t i = 0; i < options->cardinality; i++){
+            random_word(&state, pool + i * (width + 1), width);
+        }
+    }
+
+    for(size_t col = 0; col < options->cols; col++){
+        fprintf(file, "%sc%zu", col ? "," : "", col);
+    }
+    fputc('\n', file);
+
+    for(size_t row = 0; row < options->rows; row++){
+        for(size_t col = 0; col < options->cols; col++){
+            if(col){
+                fputc(',', file);
+            }
+
+            if(numeric[col]){
+                // up to width digits, every other numeric column gets a decimal part
+                size_t digits = width < 18 ? width : 18;
+                uint64_t limit = 1;
+                for(size_t i = 0; i < digits; i++){
+                    limit *= 10;
+                }
+                uint64_t value = next_random(&state) % limit;
+                if(col % 2){
+                    fprintf(file, "%llu.%02llu", (unsigned long long)(value / 100), (unsigned long long)(value % 100));
+                } else {
+                    fprintf(file, "%llu", (unsigned long long)value);
+                }
+                continue;
+            }
+
+            const char *value = word;
+            if(pool){
+                value = pool + (next_random(&state) % options->cardinality) * (width + 1);
+            } else {
+                random_word(&state, word, width);
+            }
+
+            if(options->quote > 0 && next_unit(&state) < options->quote){
+                // the embedded delimiter and quote make the tokenizer take the slow path
+                fprintf(file, "\"%.*s,\"\"%s\"", (int)(width / 2), value, value + width / 2);
+            } else {
+                fputs(value, file);
+            }
+        }
+        fputc('\n', file);
+    }
+
+    free(pool);
+    free(word);
+    free(numeric);
+    if(ferror(file)){
+        perror("Error Writing Output File");
+        return -1;
+    }
+    return 0;
+}
+
+// writes to <filename>.tmp and only renames it into place once it is complete,
+// so an interrupted or failed run never leaves a truncated file behind to be reused
+static int generate_csv(const char *filename, const GenerateOptions *options)
+{
+    char temp_filename[4096];
+    if(snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename) >= (int)sizeof(temp_filename)){
+        fprintf(stderr, "Error: Output Path Too Long %s\n", filename);
+        return -1;
+    }
+
+    FILE *file = fopen(temp_filename, "w");
+    if(file == NULL){
+        perror("Error Opening Output File");
+        return -1;
+    }
+    setvbuf(file, NULL, _IOFBF, BENCH_WRITE_BUFFER);
+
+    int result = write_generated_csv(file, options);
+    if(fclose(file) != 0){
+        perror("Error Closing Output File");
+        result = -1;
+    }
+    if(result == 0 && rename(temp_filename, filename) != 0){
+        perror("Error Renaming Output File");
+        result = -1;
+    }
+    if(result != 0){
+        unlink(temp_filename);
+    }
+    return result;
+}
+
+
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0){
+        return -1;
+    }
+    return usage.ru_maxrss; // kilobytes on linux
+}
+
+static double ms(uint64_t ns)
+{
+    return ns / 1e6;
+}
+
+// writes value as a json string literal, escaping quotes, backslashes and control characters
+static void print_json_string(const char *value)
+{
+    putchar('"');
+    for(const unsigned char *p = (const unsigned char *)value; *p; p++){
+        if(*p == '"' || *p == '\\'){
+            putchar('\\');
+            putchar(*p);
+        } else if(*p < 0x20){
+            printf("\\u%04x", *p);
+        } else {
+            putchar(*p);
+        }
+    }
+    putchar('"');
+}
+
+// FNV-1a 64 over the whole file, so results can be matched to the exact input they were measured on
+static int file_checksum(const char *filename, uint64_t *checksum)
+{
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL){
+        perror("Error Opening File For Checksum");
+        return -1;
+    }
+    static unsigned char chunk[CHUNK_SIZE];
+    uint64_t hash = 14695981039346656037ull;
+    size_t bytes_read;
+    while((bytes_read = fread(chunk, 1, sizeof(chunk), file)) > 0){
+        for(size_t i = 0; i < bytes_read; i++){
+            hash ^= chunk[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    int result = ferror(file) ? -1 : 0;
+    if(result != 0){
+        perror("Error Reading File For Checksum");
+    }
+    fclose(file);
+    *checksum = hash;
+    return result;
+}
+
+// loads the file `repeat` times and reports the fastest run
+static int run_benchmark(const char *filename, const char *label, int repeat)
+{
+    LoadStats best = { 0 };
+    size_t rows = 0;
+    size_t cols = 0;
+    size_t frame_bytes = 0;
+
+    for(int i = 0; i < repeat; i++){
+        DataFrame frame;
+        LoadStats stats;
+        if(dataframe_load_csv_stats(&frame, filename, ',', &stats) != 0){
+            fprintf(stderr, "Error Loading File %s\n", filename);
+            return -1;
+        }
+        if(i == 0 || stats.total_ns < best.total_ns){
+            best = stats;
+        }
+        rows = frame.row_count;
+        cols = frame.column_count;
+        frame_bytes = dataframe_memory_usage(&frame);
+        dataframe_free(&frame);
+    }
+
+    uint64_t checksum;
+    if(file_checksum(filename, &checksum) != 0){
+        return -1;
+    }
+
+    double seconds = best.total_ns / 1e9;
+    printf("{\"label\":");
+    print_json_string(label);
+    printf(",\"file\":");
+    print_json_string(filename);
+    printf(",\"checksum\":\"%016llx\",\"repeat\":%d,\"bytes\":%llu,\"rows\":%zu,\"cols\":%zu,"
+        "\"total_ms\":%.3f,\"io_ms\":%.3f,\"scan_ms\":%.3f,\"tokenize_ms\":%.3f,\"convert_ms\":%.3f,\"alloc_ms\":%.3f,"
+        "\"allocations\":%llu,\"mb_per_s\":%.2f,\"rows_per_s\":%.0f,\"frame_bytes\":%zu,\"peak_rss_kb\":%ld}\n",
+        (unsigned long long)checksum, repeat, (unsigned long long)best.bytes_read, rows, cols,
+        ms(best.total_ns), ms(best.io_ns), ms(best.scan_ns), ms(best.tokenize_ns), ms(best.convert_ns), ms(best.alloc_ns),
+        (unsigned long long)best.allocations,
+        seconds > 0 ? best.bytes_read / 1e6 / seconds : 0.0,
+        seconds > 0 ? rows / seconds : 0.0,
+        frame_bytes, peak_rss_kb());
+    fflush(stdout);
+    return 0;
+}
+
+// mkdir -p
+static int make_directories(const char *directory)
+{
+    char path[4096];
+    if(directory[0] == '\0'){
+        fprintf(stderr, "Error: Empty Benchmark Directory\n");
+        return -1;
+    }
+    if(snprintf(path, sizeof(path), "%s", directory) >= (int)sizeof(path)){
+        fprintf(stderr, "Error: Benchmark Directory Too Long\n");
+        return -1;
+    }
+    // start after the first character so a leading '/' isn't taken for an empty component
+    for(char *p = path + 1; ; p++){
+        if(*p == '/' || *p == '\0'){
+            char saved = *p;
+            *p = '\0';
+            if(mkdir(path, 0755) != 0 && errno != EEXIST){
+                perror("Error Creating Benchmark Directory");
+                return -1;
+            }
+            *p = saved;
+            if(saved == '\0'){
+                return 0;
+            }
+        }
+    }
+}
+
+// every case runs in its own process so peak rss belongs to that case alone
+static int run_suite(const char *directory, int repeat)
+{
+    if(make_directories(directory) != 0){
+        return -1;
+    }
+
+    int result = 0;
+    for(size_t i = 0; i < sizeof(SUITE) / sizeof(SUITE[0]); i++){
+        // the generator parameters are part of the name, so changing a case never reuses stale data
+        const GenerateOptions *options = &SUITE[i].options;
+        char filename[4096];
+        snprintf(filename, sizeof(filename), "%s/%s-r%zu-c%zu-w%zu-n%.2f-q%.2f-k%zu-s%llu.csv",
+            directory, SUITE[i].name, options->rows, options->cols, options->width,
+            options->numeric, options->quote, options->cardinality, (unsigned long long)options->seed);
+
+        // reuse files from an earlier run, the generator is deterministic and only renames complete files into place
+        if(access(filename, R_OK) != 0){
+            fprintf(stderr, "generating %s\n", filename);
+            if(generate_csv(filename, options) != 0){
+                return -1;
+            }
+        }
+
+        pid_t pid = fork();
+        if(pid < 0){
+            perror("Error Forking Benchmark");
+            return -1;
+        }
+        if(pid == 0){
+            _exit(run_benchmark(filename, SUITE[i].name, repeat) == 0 ? 0 : 1);
+        }
+        int status;
+        if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0){
+            fprintf(stderr, "Benchmark %s failed\n", SUITE[i].name);
+            result = -1;
+        }
+    }
+    return result;
+}
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "usage:\n"
+        "  bench generate <out.csv> [--rows N] [--cols N] [--width N] [--numeric P] [--quote P] [--cardinality N] [--seed N]\n"
+        "  bench run <file.csv> [--repeat N] [--label NAME]\n"
+        "  bench suite [dir] [--repeat N]\n");
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2){
+        usage();
+        return 1;
+    }
+    const char *command = argv[1];
+    const char *path = NULL;
+
+    GenerateOptions options = { 100000, 8, 8, 0.5, 0.0, 0, 1 };
+    int repeat = BENCH_DEFAULT_REPEAT;
+    const char *label = NULL;
+
+    for(int i = 2; i < argc; i++){
+        const char *arg = argv[i];
+        if(arg[0] != '-'){
+            path = arg;
+            continue;
+        }
+        if(i + 1 >= argc){
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 1;
+        }
+        const char *value = argv[++i];
+        if(strcmp(arg, "--rows") == 0) options.rows = strtoull(value, NULL, 10);
+        else if(strcmp(arg, "--cols") == 0) options.cols = strtoull(value, NULL, 10);
+        else if(strcmp(arg, "--width") == 0) options.width = strtoull(value, NULL, 10);
+        else if(strcmp(arg, "--numeric") == 0) options.numeric = strtod(value, NULL);
+        else if(strcmp(arg, "--quote") == 0) options.quote = strtod(value, NULL);
+        else if(strcmp(arg, "--cardinality") == 0) options.cardinality = strtoull(value, NULL, 10);
+        else if(strcmp(arg, "--seed") == 0) options.seed = strtoull(value, NULL, 10);
+        else if(strcmp(arg, "--repeat") == 0) repeat = atoi(value);
+        else if(strcmp(arg, "--label") == 0) label = value;
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            usage();
+            return 1;
+        }
+    }
+    if(repeat < 1){
+        repeat = 1;
+    }
+
+    if(strcmp(command, "generate") == 0 && path && options.cols > 0){
+        return generate_csv(path, &options) == 0 ? 0 : 1;
+    }
+    if(strcmp(command, "run") == 0 && path){
+        return run_benchmark(path, label ? label : path, repeat) == 0 ? 0 : 1;
+    }
+    if(strcmp(command, "suite") == 0){
+        return run_suite(path ? path : "data/bench", repeat) == 0 ? 0 : 1;
+    }
+    usage();
+    return 1;
+}
@@ -0,0 +1,546 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dataframe.h"
+#include "export.h"
+
+// sanity checks for the column helpers, the csv loader and the exporter, exits non-zero if any check fails
+//
+// build: cc -O2 -pthread -o check check.c dataframe.c export.c && ./check
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if(!(condition)){ \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while(0)
+
+
+static size_t group_count_of(const GroupCounts *groups, const char *key)
+{
+    for(size_t i = 0; i < groups->num_groups; i++){
+        if(strcmp(groups->keys[i], key) == 0){
+            return groups->counts[i];
+        }
+    }
+    return 0;
+}
+
+// the column should give the same answers whichever way it is stored
+static void check_filter_and_group(const Column *column, const char *value, size_t expected_matches)
+{
+    size_t *rows = malloc(column->length * sizeof(size_t));
+    if(rows == NULL){
+        perror("Error allocating memory for filter rows");
+        exit(1);
+    }
+
+    size_t matches = column_filter_equal(column, value, rows);
+    CHECK(matches == expected_matches);
+    for(size_t i = 0; i < matches; i++){
+        CHECK(strcmp(column_value_at(column, rows[i]), value) == 0);
+        CHECK(i == 0 || rows[i] > rows[i - 1]);
+    }
+    CHECK(column_filter_equal(column, "not in the column", rows) == 0);
+
+    GroupCounts groups;
+    CHECK(column_group_count(column, &groups) == 0);
+    size_t total = 0;
+    for(size_t i = 0; i < groups.num_groups; i++){
+        total += groups.counts[i];
+    }
+    CHECK(total == column->length);
+    CHECK(group_count_of(&groups, value) == expected_matches);
+    group_counts_free(&groups);
+
+    free(rows);
+}
+
+static void check_dictionary_column(void)
+{
+    static const char *statuses[] = { "ok", "fail", "pending" };
+    Column column;
+    CHECK(column_init(&column, "status") == 0);
+    for(size_t row = 0; row < 10000; row++){
+        CHECK(column_append(&column, statuses[row % 3]) == 0);
+    }
+    CHECK(column.encoding == COLUMN_DICT);
+    CHECK(column.code_width == 1);
+    CHECK(column.dict.count == 3);
+    check_filter_and_group(&column, "ok", 3334);
+    check_filter_and_group(&column, "pending", 3333);
+    column_free(&column);
+}
+
+// more than 256 distinct values, so the codes have to widen to uint16_t
+static void check_wide_dictionary_column(void)
+{
+    Column column;
+    char value[32];
+    CHECK(column_init(&column, "country") == 0);
+    for(size_t row = 0; row < 20000; row++){
+        snprintf(value, sizeof(value), "C%zu", row % 1000);
+        CHECK(column_append(&column, value) == 0);
+    }
+    CHECK(column.encoding == COLUMN_DICT);
+    CHECK(column.code_width == 2);
+    CHECK(column.dict.count == 1000);
+    check_filter_and_group(&column, "C999", 20);
+    check_filter_and_group(&column, "C0", 20);
+    column_free(&column);
+}
+
+// every early value distinct, so the column falls back to plain strings
+static void check_plain_column(void)
+{
+    Column column;
+    char value[32];
+    CHECK(column_init(&column, "id") == 0);
+    for(size_t row = 0; row < DICT_EARLY_ROWS; row++){
+        snprintf(value, sizeof(value), "id%zu", row);
+        CHECK(column_append(&column, value) == 0);
+    }
+    for(size_t row = 0; row < 10; row++){
+        CHECK(column_append(&column, "id7") == 0);
+    }
+    CHECK(column.encoding == COLUMN_PLAIN);
+    CHECK(strcmp(column_value_at(&column, 7), "id7") == 0);
+    check_filter_and_group(&column, "id7", 11);
+    check_filter_and_group(&column, "id4095", 1);
+
+    GroupCounts groups;
+    CHECK(column_group_count(&column, &groups) == 0);
+    CHECK(groups.num_groups == DICT_EARLY_ROWS);
+    group_counts_free(&groups);
+    column_free(&column);
+}
+
+// writes text to a temp file and loads it, returns what dataframe_load_csv() returned
+static int load_text(const char *text, size_t length, char delimiter, DataFrame *frame)
+{
+    char path[] = "/tmp/read_csv_check_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0){
+        perror("Error Creating Temp File");
+        exit(1);
+    }
+    FILE *file = fdopen(fd, "w");
+    if(file == NULL || fwrite(text, 1, length, file) != length || fclose(file) != 0){
+        perror("Error Writing Temp File");
+        exit(1);
+    }
+    int result = dataframe_load_csv(frame, path, delimiter);
+    unlink(path);
+    return result;
+}
+
+static int load_string(const char *text, DataFrame *frame)
+{
+    return load_text(text, strlen(text), ',', frame);
+}
+
+static int cell_is(const DataFrame *frame, size_t row, size_t col, const char *expected)
+{
+    return row < frame->row_count && col < frame->column_count
+        && strcmp(column_value_at(&frame->columns[col], row), expected) == 0;
+}
+
+static void check_load_basic(void)
+{
+    DataFrame frame;
+    // CRLF endings, a blank line, a short row and a last line without a newline
+    CHECK(load_string("a,b,c\r\n1,2,3\r\n\r\n4\r\n,,\n5,6,7", &frame) == 0);
+    CHECK(frame.column_count == 3);
+    CHECK(strcmp(frame.columns[2].name, "c") == 0);
+    CHECK(frame.row_count == 4);
+    CHECK(cell_is(&frame, 0, 2, "3"));
+    CHECK(cell_is(&frame, 1, 0, "4"));
+    CHECK(cell_is(&frame, 1, 1, ""));
+    CHECK(cell_is(&frame, 1, 2, ""));
+    CHECK(cell_is(&frame, 2, 0, ""));
+    CHECK(cell_is(&frame, 3, 2, "7"));
+    dataframe_free(&frame);
+}
+
+static void check_load_quotes(void)
+{
+    DataFrame frame;
+    // embedded delimiter, escaped quotes, newlines (LF and CRLF) inside quotes,
+    // and a quote in the middle of an unquoted field, which is just a character
+    CHECK(load_string(
+        "a,b\n"
+        "\"x,\"\"y\"\"\",2\n"
+        "\"line one\nline two\",3\n"
+        "\"crlf\r\ninside\",\"\"\n"
+        "q\"r,s\n"
+        "t,u\n", &frame) == 0);
+    CHECK(frame.row_count == 5);
+    CHECK(cell_is(&frame, 0, 0, "x,\"y\""));
+    CHECK(cell_is(&frame, 0, 1, "2"));
+    CHECK(cell_is(&frame, 1, 0, "line one\nline two"));
+    CHECK(cell_is(&frame, 1, 1, "3"));
+    CHECK(cell_is(&frame, 2, 0, "crlf\r\ninside"));
+    CHECK(cell_is(&frame, 2, 1, ""));
+    CHECK(cell_is(&frame, 3, 0, "q\"r"));
+    CHECK(cell_is(&frame, 4, 1, "u"));
+    dataframe_free(&frame);
+}
+
+static void check_load_errors(void)
+{
+    DataFrame frame;
+    fprintf(stderr, "(the next loader errors are expected)\n");
+    // a quote that is never closed swallows the rest of the file and then fails
+    CHECK(load_string("a,b\n\"x,2\n3,4\n", &frame) != 0);
+    CHECK(frame.columns == NULL && frame.row_count == 0);
+    // more columns than the header
+    CHECK(load_string("a,b\n1,2,3\n", &frame) != 0);
+}
+
+// the partial record at the end of a chunk is carried over and rescanned from its start,
+// so put quoted multi-line fields across the CHUNK_SIZE boundary
+static void check_load_across_chunks(void)
+{
+    size_t capacity = 4 * CHUNK_SIZE;
+    char *text = malloc(capacity);
+    char *long_value = malloc(2 * CHUNK_SIZE);
+    if(text == NULL || long_value == NULL){
+        perror("Error allocating memory for chunk check");
+        exit(1);
+    }
+
+    // filler rows up to just before the first boundary
+    size_t length = 0;
+    length += sprintf(text + length, "id,value\n");
+    size_t filler_rows = 0;
+    while(length < CHUNK_SIZE - 64){
+        length += sprintf(text + length, "%zu,filler\n", filler_rows++);
+    }
+
+    // a quoted field with newlines and escaped quotes that straddles the boundary
+    const char *straddling = "first line\nsecond \"line\"\nthird line, with a comma\nfourth";
+    length += sprintf(text + length, "straddle,\"first line\nsecond \"\"line\"\"\nthird line, with a comma\nfourth\"\n");
+    CHECK(length > CHUNK_SIZE);
+
+    // a quoted field longer than a whole chunk, with newlines in it, so the carry over has to grow
+    size_t long_length = 0;
+    while(long_length < CHUNK_SIZE + 1000){
+        long_length += sprintf(long_value + long_length, "row %zu of a long value\n", long_length);
+    }
+    length += sprintf(text + length, "long,\"%s\"\nlast,done", long_value);
+
+    DataFrame frame;
+    CHECK(load_text(text, length, ',', &frame) == 0);
+    CHECK(frame.row_count == filler_rows + 3);
+    CHECK(cell_is(&frame, filler_rows - 1, 1, "filler"));
+    CHECK(cell_is(&frame, filler_rows, 0, "straddle"));
+    CHECK(cell_is(&frame, filler_rows, 1, straddling));
+    CHECK(cell_is(&frame, filler_rows + 1, 0, "long"));
+    CHECK(cell_is(&frame, filler_rows + 1, 1, long_value));
+    CHECK(cell_is(&frame, filler_rows + 2, 1, "done"));
+    dataframe_free(&frame);
+
+    free(long_value);
+    free(text);
+}
+
+// builds a frame by hand, values[row * column_count + col]
+static void frame_from_values(DataFrame *frame, size_t column_count, const char **names, const char **values, size_t row_count)
+{
+    memset(frame, 0, sizeof(*frame));
+    frame->columns = calloc(column_count, sizeof(Column));
+    if(frame->columns == NULL){
+        perror("Error allocating memory for columns");
+        exit(1);
+    }
+    for(size_t col = 0; col < column_count; col++){
+        CHECK(column_init(&frame->columns[col], names[col]) == 0);
+        frame->column_count++;
+    }
+    for(size_t row = 0; row < row_count; row++){
+        for(size_t col = 0; col < column_count; col++){
+            CHECK(column_append(&frame->columns[col], values[row * column_count + col]) == 0);
+        }
+        frame->row_count++;
+    }
+}
+
+// exports into a temp file and reads it back, the caller frees the result
+static char *export_to_memory(const DataFrame *frame, ExportFormat format, int threads, size_t *length)
+{
+    char path[] = "/tmp/read_csv_check_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0){
+        perror("Error Creating Temp File");
+        exit(1);
+    }
+    close(fd);
+
+    ExportOptions options = { .format = format, .header = 1, .threads = threads };
+    CHECK(dataframe_export_file(frame, path, &options) == 0);
+
+    FILE *file = fopen(path, "rb");
+    if(file == NULL){
+        perror("Error Opening Export");
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(size + 1);
+    if(data == NULL || fread(data, 1, size, file) != (size_t)size){
+        perror("Error Reading Export");
+        exit(1);
+    }
+    data[size] = '\0';
+    fclose(file);
+    unlink(path);
+    *length = size;
+    return data;
+}
+
+static void check_export_quoting(void)
+{
+    const char *names[] = { "name", "note" };
+    const char *values[] = {
+        "plain",     "a,b",
+        "say \"hi\"", "tab\there",
+        "cr\rlf",    "two\nlines",
+        "",          "",
+    };
+    DataFrame frame;
+    frame_from_values(&frame, 2, names, values, 4);
+
+    size_t length;
+    char *csv = export_to_memory(&frame, EXPORT_CSV, 1, &length);
+    const char *expected_csv =
+        "name,note\n"
+        "plain,\"a,b\"\n"
+        "\"say \"\"hi\"\"\",tab\there\n"
+        "\"cr\rlf\",\"two\nlines\"\n"
+        ",\n";
+    CHECK(length == strlen(expected_csv) && memcmp(csv, expected_csv, length) == 0);
+
+    // in tsv the tab is special and the comma is not
+    char *tsv = export_to_memory(&frame, EXPORT_TSV, 1, &length);
+    const char *expected_tsv =
+        "name\tnote\n"
+        "plain\ta,b\n"
+        "\"say \"\"hi\"\"\"\t\"tab\there\"\n"
+        "\"cr\rlf\"\t\"two\nlines\"\n"
+        "\t\n";
+    CHECK(length == strlen(expected_tsv) && memcmp(tsv, expected_tsv, length) == 0);
+
+    // csv -> tsv -> csv gives the same csv back
+    DataFrame reloaded;
+    CHECK(load_text(tsv, length, '\t', &reloaded) == 0);
+    CHECK(reloaded.row_count == frame.row_count);
+    size_t round_trip_length;
+    char *round_trip = export_to_memory(&reloaded, EXPORT_CSV, 1, &round_trip_length);
+    CHECK(round_trip_length == strlen(expected_csv) && memcmp(round_trip, expected_csv, round_trip_length) == 0);
+
+    free(round_trip);
+    dataframe_free(&reloaded);
+    free(tsv);
+    free(csv);
+    dataframe_free(&frame);
+}
+
+// an empty value alone on its line has to be written as "" or the loader skips the line
+static void check_export_single_column(void)
+{
+    const char *names[] = { "a" };
+    const char *values[] = { "x", "", "y" };
+    DataFrame frame;
+    frame_from_values(&frame, 1, names, values, 3);
+
+    size_t length;
+    char *csv = export_to_memory(&frame, EXPORT_CSV, 1, &length);
+    const char *expected = "a\nx\n\"\"\ny\n";
+    CHECK(length == strlen(expected) && memcmp(csv, expected, length) == 0);
+
+    DataFrame reloaded;
+    CHECK(load_text(csv, length, ',', &reloaded) == 0);
+    CHECK(reloaded.row_count == 3);
+    CHECK(cell_is(&reloaded, 1, 0, ""));
+    dataframe_free(&reloaded);
+    free(csv);
+    dataframe_free(&frame);
+}
+
+// parallel output has to be byte for byte the serial output, across several tasks and waves
+static void check_export_parallel(void)
+{
+    size_t row_count = EXPORT_ROWS_PER_TASK * 5 + 17;
+    const char *names[] = { "status", "id", "note" };
+    const char **values = malloc(row_count * 3 * sizeof(char *));
+    char *ids = malloc(row_count * 16);
+    if(values == NULL || ids == NULL){
+        perror("Error allocating memory for parallel check");
+        exit(1);
+    }
+    static const char *statuses[] = { "ok", "fail", "needs \"review\"" };
+    static const char *notes[] = { "", "a,b", "multi\nline", "plain" };
+    for(size_t row = 0; row < row_count; row++){
+        snprintf(ids + row * 16, 16, "%zu", row);
+        values[row * 3] = statuses[row % 3];
+        values[row * 3 + 1] = ids + row * 16;
+        values[row * 3 + 2] = notes[row % 4];
+    }
+    DataFrame frame;
+    frame_from_values(&frame, 3, names, values, row_count);
+    CHECK(frame.columns[1].encoding == COLUMN_PLAIN);
+
+    size_t serial_length;
+    char *serial = export_to_memory(&frame, EXPORT_CSV, 1, &serial_length);
+    for(int threads = 2; threads <= 7; threads += 5){
+        size_t parallel_length;
+        char *parallel = export_to_memory(&frame, EXPORT_CSV, threads, &parallel_length);
+        CHECK(parallel_length == serial_length && memcmp(parallel, serial, serial_length) == 0);
+        free(parallel);
+    }
+
+    DataFrame reloaded;
+    CHECK(load_text(serial, serial_length, ',', &reloaded) == 0);
+    CHECK(reloaded.row_count == row_count);
+    CHECK(cell_is(&reloaded, row_count - 1, 1, ids + (row_count - 1) * 16));
+    CHECK(cell_is(&reloaded, 2, 0, "needs \"review\""));
+    dataframe_free(&reloaded);
+
+    free(serial);
+    dataframe_free(&frame);
+    free(ids);
+    free(values);
+}
+
+// reads the binary dump back following the layout in export.h
+static void check_export_binary(void)
+{
+    size_t row_count = DICT_EARLY_ROWS + 3;
+    const char *names[] = { "status", "id" };
+    const char **values = malloc(row_count * 2 * sizeof(char *));
+    char *ids = malloc(row_count * 16);
+    if(values == NULL || ids == NULL){
+        perror("Error allocating memory for binary check");
+        exit(1);
+    }
+    static const char *statuses[] = { "ok", "fail", "" };
+    for(size_t row = 0; row < row_count; row++){
+        snprintf(ids + row * 16, 16, "id%zu", row);
+        values[row * 2] = statuses[row % 3];
+        values[row * 2 + 1] = ids + row * 16;
+    }
+    DataFrame frame;
+    frame_from_values(&frame, 2, names, values, row_count);
+    CHECK(frame.columns[0].encoding == COLUMN_DICT);
+    CHECK(frame.columns[1].encoding == COLUMN_PLAIN);
+
+    size_t length;
+    char *data = export_to_memory(&frame, EXPORT_BINARY, 1, &length);
+    const char *ptr = data;
+    const char *end = data + length;
+#define TAKE(destination, size) do { \
+        CHECK(ptr + (size) <= end); \
+        if(ptr + (size) > end) goto done; \
+        memcpy((destination), ptr, (size)); \
+        ptr += (size); \
+    } while(0)
+
+    char magic[8];
+    uint64_t rows, columns;
+    TAKE(magic, 8);
+    CHECK(memcmp(magic, EXPORT_BINARY_MAGIC, 8) == 0);
+    TAKE(&rows, sizeof(rows));
+    TAKE(&columns, sizeof(columns));
+    CHECK(rows == row_count && columns == 2);
+
+    for(size_t col = 0; col < columns; col++){
+        const Column *column = &frame.columns[col];
+        uint32_t name_length;
+        char name[64] = { 0 };
+        uint8_t encoding, code_width;
+        TAKE(&name_length, sizeof(name_length));
+        CHECK(name_length < sizeof(name));
+        if(name_length >= sizeof(name)) goto done;
+        TAKE(name, name_length);
+        CHECK(strcmp(name, column->name) == 0);
+        TAKE(&encoding, 1);
+        TAKE(&code_width, 1);
+
+        if(encoding == 0){
+            CHECK(column->encoding == COLUMN_DICT && code_width == column->code_width);
+            uint32_t dict_count;
+            TAKE(&dict_count, sizeof(dict_count));
+            CHECK(dict_count == column->dict.count);
+            for(uint32_t code = 0; code < dict_count; code++){
+                uint32_t value_length;
+                TAKE(&value_length, sizeof(value_length));
+                CHECK(ptr + value_length <= end);
+                if(ptr + value_length > end) goto done;
+                CHECK(value_length == strlen(column->dict.values[code])
+                    && memcmp(ptr, column->dict.values[code], value_length) == 0);
+                ptr += value_length;
+            }
+            CHECK(ptr + rows * code_width <= end);
+            if(ptr + rows * code_width > end) goto done;
+            CHECK(memcmp(ptr, column->codes, rows * code_width) == 0);
+            ptr += rows * code_width;
+        } else {
+            CHECK(encoding == 1 && column->encoding == COLUMN_PLAIN);
+            uint64_t *offsets = malloc((rows + 1) * sizeof(uint64_t));
+            if(offsets == NULL){
+                perror("Error allocating memory for offsets");
+                exit(1);
+            }
+            TAKE(offsets, (rows + 1) * sizeof(uint64_t));
+            CHECK(offsets[0] == 0);
+            const char *bytes = ptr;
+            CHECK(ptr + offsets[rows] <= end);
+            if(ptr + offsets[rows] <= end){
+                for(size_t row = 0; row < rows; row++){
+                    const char *value = column_value_at(column, row);
+                    CHECK(offsets[row + 1] - offsets[row] == strlen(value)
+                        && memcmp(bytes + offsets[row], value, strlen(value)) == 0);
+                }
+                ptr += offsets[rows];
+            }
+            free(offsets);
+        }
+    }
+    // nothing left over
+    CHECK(ptr == end);
+#undef TAKE
+
+done:
+    free(data);
+    dataframe_free(&frame);
+    free(ids);
+    free(values);
+}
+
+
+int main()
+{
+    check_dictionary_column();
+    check_wide_dictionary_column();
+    check_plain_column();
+    check_load_basic();
+    check_load_quotes();
+    check_load_errors();
+    check_load_across_chunks();
+    check_export_quoting();
+    check_export_single_column();
+    check_export_parallel();
+    check_export_binary();
+
+    if(failures){
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
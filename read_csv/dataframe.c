@@ -0,0 +1,936 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dataframe.h"
+
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// the stats pointer is NULL outside of benchmarks, in which case we never touch the clock
+static uint64_t stats_clock(const LoadStats *stats)
+{
+    return stats ? now_ns() : 0;
+}
+
+static void stats_add_alloc(LoadStats *stats, uint64_t started)
+{
+    if(stats){
+        stats->alloc_ns += now_ns() - started;
+        stats->allocations++;
+    }
+}
+
+
+// FNV-1a, cheap and good enough for short categorical strings
+static uint32_t hash_string(const char *value)
+{
+    uint32_t hash = 2166136261u;
+    for(const unsigned char *p = (const unsigned char *)value; *p; p++){
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+void intern_table_init(InternTable *table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+void intern_table_free(InternTable *table)
+{
+    for(uint32_t i = 0; i < table->count; i++){
+        free(table->values[i]);
+    }
+    free(table->values);
+    free(table->hashes);
+    free(table->slots);
+    intern_table_init(table);
+}
+
+int64_t intern_table_find(const InternTable *table, const char *value)
+{
+    if(table->slots_capacity == 0){
+        return -1;
+    }
+    uint32_t hash = hash_string(value);
+    uint32_t mask = table->slots_capacity - 1;
+    // linear probing, the table is never more than half full so this always hits an empty slot
+    for(uint32_t i = hash & mask;; i = (i + 1) & mask){
+        uint32_t slot = table->slots[i];
+        if(slot == 0){
+            return -1;
+        }
+        uint32_t code = slot - 1;
+        if(table->hashes[code] == hash && strcmp(table->values[code], value) == 0){
+            return code;
+        }
+    }
+}
+
+// double the slot array and re-insert every code using the stored hashes
+static int intern_table_grow_slots(InternTable *table)
+{
+    uint32_t new_capacity = table->slots_capacity ? table->slots_capacity * 2 : DICT_INITIAL_SLOTS;
+    uint32_t *slots = calloc(new_capacity, sizeof(uint32_t));
+    if(slots == NULL){
+        perror("Error allocating memory for intern table slots");
+        return -1;
+    }
+    uint32_t mask = new_capacity - 1;
+    for(uint32_t code = 0; code < table->count; code++){
+        uint32_t i = table->hashes[code] & mask;
+        while(slots[i] != 0){
+            i = (i + 1) & mask;
+        }
+        slots[i] = code + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slots_capacity = new_capacity;
+    return 0;
+}
+
+static int64_t intern_value(InternTable *table, const char *value, LoadStats *stats)
+{
+    // keep the load factor at or below 1/2
+    if((uint64_t)(table->count + 1) * 2 > table->slots_capacity){
+        uint64_t started = stats_clock(stats);
+        int grown = intern_table_grow_slots(table);
+        stats_add_alloc(stats, started);
+        if(grown != 0){
+            return -1;
+        }
+    }
+
+    uint32_t hash = hash_string(value);
+    uint32_t mask = table->slots_capacity - 1;
+    uint32_t i = hash & mask;
+    while(table->slots[i] != 0){
+        uint32_t code = table->slots[i] - 1;
+        if(table->hashes[code] == hash && strcmp(table->values[code], value) == 0){
+            return code;
+        }
+        i = (i + 1) & mask;
+    }
+
+    // not seen before, give it the next code
+    uint64_t started = stats_clock(stats);
+    if(table->count == table->capacity){
+        uint32_t new_capacity = table->capacity ? table->capacity * 2 : DICT_INITIAL_SLOTS / 2;
+        char **values = realloc(table->values, new_capacity * sizeof(char *));
+        if(values == NULL){
+            perror("Error reallocating memory for intern table values");
+            return -1;
+        }
+        table->values = values;
+        uint32_t *hashes = realloc(table->hashes, new_capacity * sizeof(uint32_t));
+        if(hashes == NULL){
+            perror("Error reallocating memory for intern table hashes");
+            return -1;
+        }
+        table->hashes = hashes;
+        table->capacity = new_capacity;
+    }
+
+    size_t length = strlen(value);
+    char *copy = malloc(length + 1);
+    stats_add_alloc(stats, started);
+    if(copy == NULL){
+        perror("Error Duplicating Intern Value");
+        return -1;
+    }
+    memcpy(copy, value, length + 1);
+    table->bytes += length + 1;
+    uint32_t code = table->count++;
+    table->values[code] = copy;
+    table->hashes[code] = hash;
+    table->slots[i] = code + 1;
+    return code;
+}
+
+int64_t intern_table_intern(InternTable *table, const char *value)
+{
+    return intern_value(table, value, NULL);
+}
+
+
+// copies value into the arena, starting a new block when the current one is full
+static char *string_arena_copy(StringArena *arena, const char *value, size_t length, LoadStats *stats)
+{
+    StringBlock *block = arena->head;
+    if(block == NULL || block->capacity - block->used < length + 1){
+        uint64_t started = stats_clock(stats);
+        size_t capacity = length + 1 > STRING_ARENA_BLOCK_SIZE ? length + 1 : STRING_ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(StringBlock) + capacity);
+        stats_add_alloc(stats, started);
+        if(block == NULL){
+            perror("Error allocating memory for string block");
+            return NULL;
+        }
+        block->used = 0;
+        block->capacity = capacity;
+        arena->bytes += sizeof(StringBlock) + capacity;
+        if(arena->head != NULL && capacity > STRING_ARENA_BLOCK_SIZE){
+            // an oversized value gets a block of its own, keep filling the current one
+            block->next = arena->head->next;
+            arena->head->next = block;
+        } else {
+            block->next = arena->head;
+            arena->head = block;
+        }
+    }
+    char *copy = block->data + block->used;
+    memcpy(copy, value, length + 1);
+    block->used += length + 1;
+    return copy;
+}
+
+static void string_arena_free(StringArena *arena)
+{
+    StringBlock *block = arena->head;
+    while(block != NULL){
+        StringBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->bytes = 0;
+}
+
+
+int column_init(Column *column, const char *name)
+{
+    memset(column, 0, sizeof(*column));
+    column->name = strdup(name);
+    if(column->name == NULL){
+        perror("Error Duplicating Column Name");
+        return -1;
+    }
+    column->encoding = COLUMN_DICT;
+    column->code_width = 1;
+    column->capacity = INITIAL_ROWS_CAPACITY;
+    column->codes = malloc(column->capacity * column->code_width);
+    if(column->codes == NULL){
+        perror("Error allocating memory for column codes");
+        free(column->name);
+        return -1;
+    }
+    intern_table_init(&column->dict);
+    column->next_dict_check = DICT_EARLY_ROWS;
+    return 0;
+}
+
+void column_free(Column *column)
+{
+    string_arena_free(&column->strings);
+    free(column->values);
+    free(column->codes);
+    intern_table_free(&column->dict);
+    free(column->name);
+    memset(column, 0, sizeof(*column));
+}
+
+static int column_grow(Column *column)
+{
+    size_t new_capacity = column->capacity * 2;
+    if(column->encoding == COLUMN_DICT){
+        void *codes = realloc(column->codes, new_capacity * column->code_width);
+        if(codes == NULL){
+            perror("Error reallocating memory for column codes");
+            return -1;
+        }
+        column->codes = codes;
+    } else {
+        char **values = realloc(column->values, new_capacity * sizeof(char *));
+        if(values == NULL){
+            perror("Error reallocating memory for column values");
+            return -1;
+        }
+        column->values = values;
+    }
+    column->capacity = new_capacity;
+    return 0;
+}
+
+// switch the code array to a wider integer type, converting back to front so it can be done in place
+static int column_widen_codes(Column *column, uint8_t new_width)
+{
+    void *codes = realloc(column->codes, column->capacity * new_width);
+    if(codes == NULL){
+        perror("Error reallocating memory for wider column codes");
+        return -1;
+    }
+    for(size_t row = column->length; row-- > 0;){
+        uint32_t code;
+        switch(column->code_width){
+            case 1: code = ((uint8_t *)codes)[row]; break;
+            case 2: code = ((uint16_t *)codes)[row]; break;
+            default: code = ((uint32_t *)codes)[row]; break;
+        }
+        if(new_width == 2){
+            ((uint16_t *)codes)[row] = (uint16_t)code;
+        } else {
+            ((uint32_t *)codes)[row] = code;
+        }
+    }
+    column->codes = codes;
+    column->code_width = new_width;
+    return 0;
+}
+
+// should the dictionary give way to plain strings?
+// it has to be bigger than plain storage so far (strings, code -> string / hash arrays, hash slots, codes
+// against a pointer per row plus the strings packed into arena blocks), and the rows since the previous
+// checkpoint have to cost more per row as dictionary entries and codes than as plain strings.
+// the second part keeps columns whose distinct values are still arriving but slowing down,
+// which is where the dictionary pays off over the rest of the file
+static int column_dict_too_big(const Column *column, size_t rows)
+{
+    const InternTable *dict = &column->dict;
+    size_t dict_bytes = dict->bytes + (size_t)dict->count * STRING_ALLOC_OVERHEAD
+        + (size_t)dict->capacity * (sizeof(char *) + sizeof(uint32_t))
+        + (size_t)dict->slots_capacity * sizeof(uint32_t)
+        + rows * column->code_width;
+    size_t plain_bytes = column->value_bytes + rows * sizeof(char *);
+    if(dict_bytes <= plain_bytes){
+        return 0;
+    }
+
+    double average_bytes = (double)column->value_bytes / rows;
+    double new_values = dict->count - column->checked_distinct;
+    double window = rows - column->checked_rows;
+    // a new entry: its string, allocation overhead, value + hash array slots, and ~2 hash slots at half load
+    double entry_bytes = average_bytes + STRING_ALLOC_OVERHEAD + sizeof(char *) + sizeof(uint32_t) + 2 * sizeof(uint32_t);
+    double dict_per_row = new_values / window * entry_bytes + column->code_width;
+    double plain_per_row = average_bytes + sizeof(char *);
+    return dict_per_row > plain_per_row;
+}
+
+// too many distinct values for a dictionary to pay off, give every cell its own string
+static int column_fallback_to_plain(Column *column)
+{
+    char **values = malloc(column->capacity * sizeof(char *));
+    if(values == NULL){
+        perror("Error allocating memory for plain column values");
+        return -1;
+    }
+    // the caller times the whole conversion as allocation, so the arena doesn't time its blocks again
+    for(size_t row = 0; row < column->length; row++){
+        const char *value = column->dict.values[column_code_at(column, row)];
+        values[row] = string_arena_copy(&column->strings, value, strlen(value), NULL);
+        if(values[row] == NULL){
+            string_arena_free(&column->strings);
+            free(values);
+            return -1;
+        }
+    }
+    free(column->codes);
+    column->codes = NULL;
+    column->code_width = 0;
+    intern_table_free(&column->dict);
+    column->values = values;
+    column->encoding = COLUMN_PLAIN;
+    return 0;
+}
+
+static int column_append_value(Column *column, const char *value, LoadStats *stats)
+{
+    if(column->length == column->capacity){
+        uint64_t started = stats_clock(stats);
+        int grown = column_grow(column);
+        stats_add_alloc(stats, started);
+        if(grown != 0){
+            return -1;
+        }
+    }
+
+    if(column->encoding == COLUMN_DICT){
+        int64_t code = intern_value(&column->dict, value, stats);
+        if(code < 0){
+            return -1;
+        }
+
+        column->value_bytes += strlen(value) + 1;
+        size_t rows = column->length + 1;
+        // only weigh sizes at doubling checkpoints, the fallback can't be undone so one early look isn't enough
+        int too_big = 0;
+        if(rows == column->next_dict_check){
+            if(rows == DICT_EARLY_ROWS){
+                // not a single repeat yet, the dictionary will never pay off
+                too_big = column->dict.count == rows;
+            } else if(rows >= DICT_SAMPLE_ROWS){
+                too_big = column_dict_too_big(column, rows);
+            }
+            // checkpoints before DICT_SAMPLE_ROWS only record where the column was
+            column->checked_rows = rows;
+            column->checked_distinct = column->dict.count;
+            column->next_dict_check *= 2;
+        }
+        if(column->dict.count > DICT_MAX_CARDINALITY || too_big)
+        {
+            uint64_t started = stats_clock(stats);
+            int converted = column_fallback_to_plain(column);
+            stats_add_alloc(stats, started);
+            if(converted != 0){
+                return -1;
+            }
+        } else {
+            uint8_t needed_width = code <= UINT8_MAX ? 1 : (code <= UINT16_MAX ? 2 : 4);
+            if(needed_width > column->code_width){
+                uint64_t started = stats_clock(stats);
+                int widened = column_widen_codes(column, needed_width);
+                stats_add_alloc(stats, started);
+                if(widened != 0){
+                    return -1;
+                }
+            }
+            switch(column->code_width){
+                case 1: ((uint8_t *)column->codes)[column->length] = (uint8_t)code; break;
+                case 2: ((uint16_t *)column->codes)[column->length] = (uint16_t)code; break;
+                default: ((uint32_t *)column->codes)[column->length] = (uint32_t)code; break;
+            }
+            column->length++;
+            return 0;
+        }
+    }
+
+    column->values[column->length] = string_arena_copy(&column->strings, value, strlen(value), stats);
+    if(column->values[column->length] == NULL){
+        return -1;
+    }
+    column->length++;
+    return 0;
+}
+
+int column_append(Column *column, const char *value)
+{
+    return column_append_value(column, value, NULL);
+}
+
+size_t column_memory_usage(const Column *column)
+{
+    size_t bytes = sizeof(*column) + strlen(column->name) + 1;
+    if(column->encoding == COLUMN_DICT){
+        const InternTable *dict = &column->dict;
+        bytes += column->capacity * column->code_width;
+        bytes += dict->capacity * (sizeof(char *) + sizeof(uint32_t));
+        bytes += dict->slots_capacity * sizeof(uint32_t);
+        for(uint32_t code = 0; code < dict->count; code++){
+            bytes += strlen(dict->values[code]) + 1;
+        }
+    } else {
+        bytes += column->capacity * sizeof(char *);
+        bytes += column->strings.bytes;
+    }
+    return bytes;
+}
+
+size_t column_filter_equal(const Column *column, const char *value, size_t *out_rows)
+{
+    size_t matches = 0;
+    if(column->encoding == COLUMN_PLAIN){
+        for(size_t row = 0; row < column->length; row++){
+            if(strcmp(column->values[row], value) == 0){
+                out_rows[matches++] = row;
+            }
+        }
+        return matches;
+    }
+
+    int64_t found = intern_table_find(&column->dict, value);
+    if(found < 0){
+        return 0;
+    }
+    uint32_t code = (uint32_t)found;
+    // switch once outside the loop so each loop is a plain integer compare
+    switch(column->code_width){
+        case 1: {
+            const uint8_t *codes = column->codes;
+            for(size_t row = 0; row < column->length; row++){
+                if(codes[row] == code) out_rows[matches++] = row;
+            }
+            break;
+        }
+        case 2: {
+            const uint16_t *codes = column->codes;
+            for(size_t row = 0; row < column->length; row++){
+                if(codes[row] == code) out_rows[matches++] = row;
+            }
+            break;
+        }
+        default: {
+            const uint32_t *codes = column->codes;
+            for(size_t row = 0; row < column->length; row++){
+                if(codes[row] == code) out_rows[matches++] = row;
+            }
+            break;
+        }
+    }
+    return matches;
+}
+
+int column_group_count(const Column *column, GroupCounts *out)
+{
+    memset(out, 0, sizeof(*out));
+    intern_table_init(&out->scratch);
+
+    if(column->encoding == COLUMN_DICT){
+        // the codes already are dense group ids
+        out->num_groups = column->dict.count;
+        out->keys = (const char **)column->dict.values;
+        out->counts = calloc(out->num_groups ? out->num_groups : 1, sizeof(size_t));
+        if(out->counts == NULL){
+            perror("Error allocating memory for group counts");
+            return -1;
+        }
+        for(size_t row = 0; row < column->length; row++){
+            out->counts[column_code_at(column, row)]++;
+        }
+        return 0;
+    }
+
+    // plain strings have to be interned first
+    size_t counts_capacity = 0;
+    for(size_t row = 0; row < column->length; row++){
+        int64_t code = intern_table_intern(&out->scratch, column->values[row]);
+        if(code < 0){
+            group_counts_free(out);
+            return -1;
+        }
+        if((size_t)code == counts_capacity){
+            size_t new_capacity = counts_capacity ? counts_capacity * 2 : INITIAL_ROWS_CAPACITY;
+            size_t *counts = realloc(out->counts, new_capacity * sizeof(size_t));
+            if(counts == NULL){
+                perror("Error reallocating memory for group counts");
+                group_counts_free(out);
+                return -1;
+            }
+            memset(counts + counts_capacity, 0, (new_capacity - counts_capacity) * sizeof(size_t));
+            out->counts = counts;
+            counts_capacity = new_capacity;
+        }
+        out->counts[code]++;
+    }
+    out->num_groups = out->scratch.count;
+    out->keys = (const char **)out->scratch.values;
+    return 0;
+}
+
+void group_counts_free(GroupCounts *groups)
+{
+    free(groups->counts);
+    intern_table_free(&groups->scratch);
+    memset(groups, 0, sizeof(*groups));
+}
+
+
+// splits the line in place and appends its fields to columns[*cols_used...], the fields point into line
+// quoted fields ("a,b" and "say ""hi""") are unquoted in place as well
+// returns the number of fields appended, or 0 on allocation failure or an unterminated quote
+static size_t split_line_into_columns(
+    char *line,
+    char delimiter,
+    char ***columns,
+    size_t *cols_used,
+    size_t *cols_capacity
+){
+    size_t col_count = *cols_used;
+    char *ptr = line;
+
+    for(;;)
+    {
+        if(col_count == *cols_capacity)
+        {
+            size_t new_capacity = *cols_capacity ? *cols_capacity * 2 : INITIAL_COLS_CAPACITY;
+            char **temp = realloc(*columns, new_capacity * sizeof(char *));
+            if(temp == NULL)
+            {
+                perror("Error reallocating memory for columns");
+                return 0;
+            }
+            *columns = temp;
+            *cols_capacity = new_capacity;
+        }
+
+        if(*ptr == '"')
+        {
+            char *field = ++ptr;
+            char *out = field;
+            int closed = 0;
+            while(*ptr)
+            {
+                if(*ptr == '"')
+                {
+                    // "" inside quotes is an escaped quote
+                    if(ptr[1] == '"'){
+                        *out++ = '"';
+                        ptr += 2;
+                        continue;
+                    }
+                    ptr++;
+                    closed = 1;
+                    break;
+                }
+                *out++ = *ptr++;
+            }
+            if(!closed)
+            {
+                fprintf(stderr, "Error: Unterminated Quoted Field. \n");
+                return 0;
+            }
+            // be lenient about junk between the closing quote and the delimiter
+            while(*ptr && *ptr != delimiter){
+                ptr++;
+            }
+            char separator = *ptr;
+            *out = '\0';
+            (*columns)[col_count++] = field;
+            if(separator == '\0'){
+                break;
+            }
+            ptr++;
+        }
+        else
+        {
+            (*columns)[col_count++] = ptr;
+            while(*ptr && *ptr != delimiter){
+                ptr++;
+            }
+            if(*ptr == '\0'){
+                break;
+            }
+            *ptr++ = '\0';
+        }
+    }
+
+    size_t appended = col_count - *cols_used;
+    *cols_used = col_count;
+    return appended;
+}
+
+// one line of the current chunk, fields[first_field ... first_field + num_fields) once tokenized
+typedef struct {
+    char *start;
+    size_t length;
+    size_t first_field;
+    size_t num_fields;
+} LineSpan;
+
+// every chunk goes through the same stages: read -> find newlines -> tokenize -> append to columns
+typedef struct {
+    DataFrame *frame;
+    char delimiter;
+    LoadStats *stats;
+    LineSpan *lines;
+    size_t lines_used;
+    size_t lines_capacity;
+    char **fields;
+    size_t fields_used;
+    size_t fields_capacity;
+    size_t line_number;
+} LoadState;
+
+static int push_line(LoadState *state, char *start, size_t length)
+{
+    if(length > 0 && start[length - 1] == '\r'){
+        start[--length] = '\0';
+    }
+
+    if(state->lines_used == state->lines_capacity){
+        uint64_t started = stats_clock(state->stats);
+        size_t new_capacity = state->lines_capacity ? state->lines_capacity * 2 : INITIAL_ROWS_CAPACITY;
+        LineSpan *temp = realloc(state->lines, new_capacity * sizeof(LineSpan));
+        stats_add_alloc(state->stats, started);
+        if(temp == NULL){
+            perror("Error reallocating memory for lines array");
+            return -1;
+        }
+        state->lines = temp;
+        state->lines_capacity = new_capacity;
+    }
+    state->lines[state->lines_used++] = (LineSpan){ .start = start, .length = length };
+    return 0;
+}
+
+// null terminates every complete line in [start, end), returns where the unfinished line begins
+// at eof the unfinished line is pushed as well
+// where a record is, as far as quoting goes, mirrors split_line_into_columns()
+typedef enum {
+    QUOTE_FIELD_START,
+    QUOTE_UNQUOTED,
+    QUOTE_QUOTED,
+    QUOTE_QUOTED_QUOTE  // a quote inside a quoted field, either closing it or the first half of ""
+} QuoteState;
+
+static QuoteState advance_quote_state(QuoteState quote, const char *ptr, const char *end, char delimiter)
+{
+    for(; ptr < end; ptr++){
+        char c = *ptr;
+        switch(quote){
+            case QUOTE_FIELD_START:
+                quote = c == '"' ? QUOTE_QUOTED : (c == delimiter ? QUOTE_FIELD_START : QUOTE_UNQUOTED);
+                break;
+            case QUOTE_UNQUOTED:
+                quote = c == delimiter ? QUOTE_FIELD_START : QUOTE_UNQUOTED;
+                break;
+            case QUOTE_QUOTED:
+                quote = c == '"' ? QUOTE_QUOTED_QUOTE : QUOTE_QUOTED;
+                break;
+            case QUOTE_QUOTED_QUOTE:
+                quote = c == '"' ? QUOTE_QUOTED : (c == delimiter ? QUOTE_FIELD_START : QUOTE_UNQUOTED);
+                break;
+        }
+    }
+    return quote;
+}
+
+static char *scan_lines(LoadState *state, char *start, char *end, int at_eof)
+{
+    char *line_start = start;
+    char *cursor = start;
+    char *newline;
+    // every chunk rescans the carried over partial line from its start, so the quote state never spans chunks
+    QuoteState quote = QUOTE_FIELD_START;
+    while((newline = memchr(cursor, '\n', end - cursor)) != NULL)
+    {
+        // only lines with a quote in them need the state machine
+        if(quote == QUOTE_QUOTED || memchr(cursor, '"', newline - cursor) != NULL){
+            quote = advance_quote_state(quote, cursor, newline, state->delimiter);
+        }
+        cursor = newline + 1;
+        if(quote == QUOTE_QUOTED){
+            // the newline is part of a quoted field, keep going
+            continue;
+        }
+        quote = QUOTE_FIELD_START;
+
+        *newline = '\0'; // null terminate current line
+        if(push_line(state, line_start, newline - line_start) != 0){
+            return NULL;
+        }
+        line_start = cursor;
+    }
+    // last line without a trailing newline
+    if(at_eof && line_start < end){
+        if(push_line(state, line_start, end - line_start) != 0){
+            return NULL;
+        }
+        line_start = end;
+    }
+    return line_start;
+}
+
+static int tokenize_lines(LoadState *state)
+{
+    state->fields_used = 0;
+    for(size_t i = 0; i < state->lines_used; i++){
+        LineSpan *line = &state->lines[i];
+        line->first_field = state->fields_used;
+        line->num_fields = 0;
+        if(line->length == 0){
+            continue;
+        }
+        line->num_fields = split_line_into_columns(
+            line->start, state->delimiter, &state->fields, &state->fields_used, &state->fields_capacity);
+        if(line->num_fields == 0){
+            fprintf(stderr, "Error Parsing Row. \n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int convert_lines(LoadState *state)
+{
+    DataFrame *frame = state->frame;
+    for(size_t i = 0; i < state->lines_used; i++){
+        const LineSpan *line = &state->lines[i];
+        char **fields = state->fields + line->first_field;
+        state->line_number++;
+        if(line->num_fields == 0){
+            continue;
+        }
+
+        // the header row determines the column count and names
+        if(frame->columns == NULL)
+        {
+            frame->columns = calloc(line->num_fields, sizeof(Column));
+            if(frame->columns == NULL){
+                perror("Error allocating memory for columns");
+                return -1;
+            }
+            for(size_t col = 0; col < line->num_fields; col++){
+                if(column_init(&frame->columns[col], fields[col]) != 0){
+                    return -1;
+                }
+                frame->column_count++;
+            }
+            continue;
+        }
+
+        if(line->num_fields > frame->column_count){
+            fprintf(stderr, "Error: Row %zu has more columns than Expected. \n", state->line_number);
+            return -1;
+        }
+
+        for(size_t col = 0; col < frame->column_count; col++){
+            // short rows are padded with empty values
+            const char *value = col < line->num_fields ? fields[col] : "";
+            if(column_append_value(&frame->columns[col], value, state->stats) != 0){
+                return -1;
+            }
+        }
+        frame->row_count++;
+    }
+    return 0;
+}
+
+int dataframe_load_csv_stats(DataFrame *frame, const char *filename, char delimiter, LoadStats *stats)
+{
+    memset(frame, 0, sizeof(*frame));
+    if(stats){
+        memset(stats, 0, sizeof(*stats));
+    }
+    uint64_t load_started = stats_clock(stats);
+
+    FILE *file = fopen(filename, "r");
+    if(file == NULL){
+        perror("Error Opening File");
+        return -1;
+    }
+
+    // the buffer always has room for the leftover partial line plus a full chunk
+    size_t buffer_capacity = CHUNK_SIZE;
+    char *buffer = malloc(buffer_capacity + 1); // +1 for null terminator
+    if(buffer == NULL){
+        perror("Error Allocating Memory For Initial Chunk Buffer");
+        fclose(file);
+        return -1;
+    }
+
+    LoadState state = { .frame = frame, .delimiter = delimiter, .stats = stats };
+    size_t carryover_len = 0; // leftovers from previous chunk
+    int result = 0;
+
+    for(;;)
+    {
+        if(buffer_capacity - carryover_len < CHUNK_SIZE){
+            // a single line is longer than what we have room for
+            uint64_t started = stats_clock(stats);
+            buffer_capacity = carryover_len + CHUNK_SIZE;
+            char *temp = realloc(buffer, buffer_capacity + 1);
+            stats_add_alloc(stats, started);
+            if(temp == NULL){
+                perror("Error reallocating memory for chunk buffer");
+                result = -1;
+                break;
+            }
+            buffer = temp;
+        }
+
+        uint64_t started = stats_clock(stats);
+        size_t bytes_read = fread(buffer + carryover_len, 1, CHUNK_SIZE, file);
+        if(stats){
+            stats->io_ns += now_ns() - started;
+            stats->bytes_read += bytes_read;
+        }
+        if(bytes_read < CHUNK_SIZE && ferror(file)){
+            perror("Error Reading File");
+            result = -1;
+            break;
+        }
+        int at_eof = bytes_read < CHUNK_SIZE;
+
+        char *end = buffer + carryover_len + bytes_read;
+        *end = '\0';
+
+        // allocations made inside a stage are reported as allocation, not as that stage
+        state.lines_used = 0;
+        started = stats_clock(stats);
+        uint64_t alloc_before = stats ? stats->alloc_ns : 0;
+        char *line_start = scan_lines(&state, buffer, end, at_eof);
+        if(stats){
+            uint64_t finished = now_ns();
+            stats->scan_ns += finished - started - (stats->alloc_ns - alloc_before);
+            stats->lines += state.lines_used;
+            started = finished;
+            alloc_before = stats->alloc_ns;
+        }
+        if(line_start == NULL){
+            result = -1;
+            break;
+        }
+
+        if(tokenize_lines(&state) != 0){
+            result = -1;
+            break;
+        }
+        if(stats){
+            uint64_t finished = now_ns();
+            stats->tokenize_ns += finished - started - (stats->alloc_ns - alloc_before);
+            stats->fields += state.fields_used;
+            started = finished;
+            alloc_before = stats->alloc_ns;
+        }
+
+        if(convert_lines(&state) != 0){
+            result = -1;
+            break;
+        }
+        if(stats){
+            stats->convert_ns += now_ns() - started - (stats->alloc_ns - alloc_before);
+        }
+
+        if(at_eof){
+            break;
+        }
+
+        // Save any leftover for the next chunk
+        carryover_len = end - line_start;
+        memmove(buffer, line_start, carryover_len);
+    }
+
+    free(state.lines);
+    free(state.fields);
+    free(buffer);
+    fclose(file);
+    if(result != 0){
+        dataframe_free(frame);
+    }
+    if(stats){
+        stats->total_ns = now_ns() - load_started;
+    }
+    return result;
+}
+
+int dataframe_load_csv(DataFrame *frame, const char *filename, char delimiter)
+{
+    return dataframe_load_csv_stats(frame, filename, delimiter, NULL);
+}
+
+void dataframe_free(DataFrame *frame)
+{
+    for(size_t col = 0; col < frame->column_count; col++){
+        column_free(&frame->columns[col]);
+    }
+    free(frame->columns);
+    memset(frame, 0, sizeof(*frame));
+}
+
+size_t dataframe_memory_usage(const DataFrame *frame)
+{
+    size_t bytes = sizeof(*frame);
+    for(size_t col = 0; col < frame->column_count; col++){
+        bytes += column_memory_usage(&frame->columns[col]);
+    }
+    return bytes;
+}
@@ -0,0 +1,157 @@
+#ifndef READ_CSV_DATAFRAME_H
+#define READ_CSV_DATAFRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHUNK_SIZE 65536 // 64KB
+#define INITIAL_ROWS_CAPACITY 256 // Initial number of rows in the dataframe
+#define INITIAL_COLS_CAPACITY 10  // Initial number of columns per row
+
+// dictionary encoding knobs
+// a column stays dictionary encoded until either:
+//   - it has more than DICT_MAX_CARDINALITY distinct values, or
+//   - all of its first DICT_EARLY_ROWS values are distinct (ids, timestamps, measurements), or
+//   - at a checkpoint (DICT_SAMPLE_ROWS rows, then every time the row count doubles) the dictionary
+//     is bigger than plain storage would be so far, and the rows since the previous checkpoint
+//     also cost more per row as dictionary than as plain strings (new values keep coming in)
+// at which point it falls back to one plain string per cell
+#define DICT_INITIAL_SLOTS 64
+#define DICT_MAX_CARDINALITY (1u << 20)
+#define DICT_EARLY_ROWS 4096
+#define DICT_SAMPLE_ROWS (1u << 18) // must be DICT_EARLY_ROWS times a power of 2
+#define STRING_ALLOC_OVERHEAD 16 // rough malloc header + rounding per strdup, used by the size estimate
+#define STRING_ARENA_BLOCK_SIZE 65536 // 64KB blocks for the strings of plain columns
+
+
+// incremental intern table: every distinct string is stored once and gets a dense code (0, 1, 2, ...)
+// lookups go through an open addressing hash table of (code + 1), 0 marks an empty slot
+typedef struct {
+    char **values;      // values[code] -> the interned string
+    uint32_t *hashes;   // hashes[code] -> hash of values[code], so we never rehash strings when growing
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *slots;
+    uint32_t slots_capacity; // always a power of 2
+    size_t bytes;            // strlen + 1 of every interned value
+} InternTable;
+
+// bump allocator for the strings of plain columns, one malloc per block instead of one per cell
+// everything is freed at once together with the column
+typedef struct StringBlock {
+    struct StringBlock *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} StringBlock;
+
+typedef struct {
+    StringBlock *head; // the block new strings go into
+    size_t bytes;      // total size of all blocks
+} StringArena;
+
+typedef enum {
+    COLUMN_DICT,
+    COLUMN_PLAIN
+} ColumnEncoding;
+
+typedef struct {
+    char *name;
+    ColumnEncoding encoding;
+    size_t length;
+    size_t capacity;
+
+    // COLUMN_DICT: one code per row, code_width is 1, 2 or 4 bytes (uint8_t / uint16_t / uint32_t)
+    uint8_t code_width;
+    void *codes;
+    InternTable dict;
+    size_t value_bytes;      // strlen + 1 of every appended value, what plain storage would need for the strings
+    size_t next_dict_check;  // row count at which the dictionary is weighed against plain storage again
+    size_t checked_rows;     // row count and distinct values at the previous checkpoint
+    uint32_t checked_distinct;
+
+    // COLUMN_PLAIN: one string per row, the strings live in the column's arena
+    char **values;
+    StringArena strings;
+} Column;
+
+typedef struct {
+    Column *columns;
+    size_t column_count;
+    size_t row_count;
+} DataFrame;
+
+// result of column_group_count(), keys[i] appeared counts[i] times
+// for dictionary columns keys[i] is simply the value of code i
+typedef struct {
+    size_t num_groups;
+    const char **keys;
+    size_t *counts;
+    InternTable scratch; // only used for plain columns
+} GroupCounts;
+
+// per-stage loader timings, filled in by dataframe_load_csv_stats()
+// conversion is appending fields to the columns (interning / copying into arena blocks),
+// allocation is every malloc / realloc the loader makes: buffers, column storage, dictionary entries
+// and string arena blocks. allocations counts those calls, alloc_ns is the time spent in them
+typedef struct {
+    uint64_t bytes_read;
+    uint64_t lines;
+    uint64_t fields;
+    uint64_t allocations;
+    uint64_t io_ns;
+    uint64_t scan_ns;
+    uint64_t tokenize_ns;
+    uint64_t convert_ns;
+    uint64_t alloc_ns;
+    uint64_t total_ns;
+} LoadStats;
+
+
+void intern_table_init(InternTable *table);
+void intern_table_free(InternTable *table);
+// returns -1 if the value is not in the table
+int64_t intern_table_find(const InternTable *table, const char *value);
+// returns the code of value, inserting a copy of it if needed. returns -1 on allocation failure
+int64_t intern_table_intern(InternTable *table, const char *value);
+
+int column_init(Column *column, const char *name);
+void column_free(Column *column);
+int column_append(Column *column, const char *value);
+
+static inline uint32_t column_code_at(const Column *column, size_t row)
+{
+    switch(column->code_width){
+        case 1: return ((const uint8_t *)column->codes)[row];
+        case 2: return ((const uint16_t *)column->codes)[row];
+        default: return ((const uint32_t *)column->codes)[row];
+    }
+}
+
+static inline const char *column_value_at(const Column *column, size_t row)
+{
+    if(column->encoding == COLUMN_DICT){
+        return column->dict.values[column_code_at(column, row)];
+    }
+    return column->values[row];
+}
+
+// bytes held by the column, including the strings it owns
+size_t column_memory_usage(const Column *column);
+
+// equality filter: writes the matching row indices to out_rows (which must hold column->length entries)
+// and returns how many matched. dictionary columns resolve value to a code once and compare codes only
+size_t column_filter_equal(const Column *column, const char *value, size_t *out_rows);
+
+// group by a single column and count rows per distinct value
+int column_group_count(const Column *column, GroupCounts *out);
+void group_counts_free(GroupCounts *groups);
+
+// the first line of the file is used for the column names
+int dataframe_load_csv(DataFrame *frame, const char *filename, char delimiter);
+// same as dataframe_load_csv(), stats is zeroed and then filled in
+int dataframe_load_csv_stats(DataFrame *frame, const char *filename, char delimiter, LoadStats *stats);
+void dataframe_free(DataFrame *frame);
+size_t dataframe_memory_usage(const DataFrame *frame);
+
+#endif
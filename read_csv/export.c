@@ -0,0 +1,473 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "export.h"
+
+
+// growable output buffer, formatted bytes pile up here and go out in a few big write() calls
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} OutBuffer;
+
+static int buffer_reserve(OutBuffer *buffer, size_t extra)
+{
+    if(buffer->length + extra <= buffer->capacity){
+        return 0;
+    }
+    size_t new_capacity = buffer->capacity ? buffer->capacity : EXPORT_BUFFER_SIZE;
+    while(new_capacity < buffer->length + extra){
+        new_capacity *= 2;
+    }
+    char *data = realloc(buffer->data, new_capacity);
+    if(data == NULL){
+        perror("Error reallocating memory for export buffer");
+        return -1;
+    }
+    buffer->data = data;
+    buffer->capacity = new_capacity;
+    return 0;
+}
+
+static int buffer_append(OutBuffer *buffer, const void *bytes, size_t length)
+{
+    if(buffer_reserve(buffer, length) != 0){
+        return -1;
+    }
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t length)
+{
+    while(length > 0){
+        ssize_t written = write(fd, data, length);
+        if(written < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            perror("Error Writing Export");
+            return -1;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+static int buffer_flush(OutBuffer *buffer, int fd)
+{
+    int result = write_all(fd, buffer->data, buffer->length);
+    buffer->length = 0;
+    return result;
+}
+
+
+// how many bytes value takes once written, *quote is set when it has to be quoted
+// alone_on_line is set for one column frames, where an empty value has to be written as ""
+// because the loader skips empty lines
+static size_t escaped_length(const char *value, char delimiter, int alone_on_line, int *quote)
+{
+    size_t length = 0;
+    size_t quotes = 0;
+    int special = 0;
+    for(const char *p = value; *p; p++){
+        char c = *p;
+        if(c == '"'){
+            quotes++;
+            special = 1;
+        } else if(c == delimiter || c == '\n' || c == '\r'){
+            special = 1;
+        }
+        length++;
+    }
+    if(length == 0 && alone_on_line){
+        special = 1;
+    }
+    *quote = special;
+    return special ? length + quotes + 2 : length;
+}
+
+// out must have room for escaped_length() bytes
+static char *write_escaped(char *out, const char *value, size_t length, int quote)
+{
+    if(!quote){
+        memcpy(out, value, length);
+        return out + length;
+    }
+    *out++ = '"';
+    for(const char *p = value; *p; p++){
+        if(*p == '"'){
+            *out++ = '"';
+        }
+        *out++ = *p;
+    }
+    *out++ = '"';
+    return out;
+}
+
+// dictionary columns are escaped once per distinct value instead of once per row
+typedef struct {
+    char **values;
+    size_t *lengths;
+} EscapedDict;
+
+typedef struct {
+    const DataFrame *frame;
+    char delimiter;
+    EscapedDict *dicts; // one per column, empty for plain columns
+} TextFormat;
+
+static void text_format_free(TextFormat *format)
+{
+    if(format->dicts == NULL){
+        return;
+    }
+    for(size_t col = 0; col < format->frame->column_count; col++){
+        EscapedDict *dict = &format->dicts[col];
+        if(dict->values){
+            for(uint32_t code = 0; code < format->frame->columns[col].dict.count; code++){
+                free(dict->values[code]);
+            }
+        }
+        free(dict->values);
+        free(dict->lengths);
+    }
+    free(format->dicts);
+    format->dicts = NULL;
+}
+
+static int text_format_init(TextFormat *format, const DataFrame *frame, char delimiter)
+{
+    format->frame = frame;
+    format->delimiter = delimiter;
+    format->dicts = calloc(frame->column_count ? frame->column_count : 1, sizeof(EscapedDict));
+    if(format->dicts == NULL){
+        perror("Error allocating memory for escaped dictionaries");
+        return -1;
+    }
+
+    for(size_t col = 0; col < frame->column_count; col++){
+        const Column *column = &frame->columns[col];
+        if(column->encoding != COLUMN_DICT){
+            continue;
+        }
+        EscapedDict *dict = &format->dicts[col];
+        uint32_t count = column->dict.count;
+        dict->values = calloc(count ? count : 1, sizeof(char *));
+        dict->lengths = malloc((count ? count : 1) * sizeof(size_t));
+        if(dict->values == NULL || dict->lengths == NULL){
+            perror("Error allocating memory for escaped dictionary");
+            text_format_free(format);
+            return -1;
+        }
+        for(uint32_t code = 0; code < count; code++){
+            const char *value = column->dict.values[code];
+            int quote;
+            size_t length = escaped_length(value, delimiter, frame->column_count == 1, &quote);
+            dict->values[code] = malloc(length ? length : 1);
+            if(dict->values[code] == NULL){
+                perror("Error allocating memory for escaped value");
+                text_format_free(format);
+                return -1;
+            }
+            write_escaped(dict->values[code], value, length, quote);
+            dict->lengths[code] = length;
+        }
+    }
+    return 0;
+}
+
+// formats rows [begin, end) into buffer, flushing to fd whenever the buffer fills up
+// fd < 0 keeps everything in the buffer (parallel mode splices the buffers afterwards)
+static int format_rows(const TextFormat *format, size_t begin, size_t end, OutBuffer *buffer, int fd)
+{
+    const DataFrame *frame = format->frame;
+    for(size_t row = begin; row < end; row++){
+        for(size_t col = 0; col < frame->column_count; col++){
+            const Column *column = &frame->columns[col];
+            const char *bytes;
+            size_t length;
+            int quote = 0;
+
+            if(column->encoding == COLUMN_DICT){
+                uint32_t code = column_code_at(column, row);
+                bytes = format->dicts[col].values[code];
+                length = format->dicts[col].lengths[code];
+            } else {
+                bytes = column->values[row];
+                length = escaped_length(bytes, format->delimiter, frame->column_count == 1, &quote);
+            }
+
+            // +1 for the delimiter or newline
+            if(buffer_reserve(buffer, length + 1) != 0){
+                return -1;
+            }
+            char *out = buffer->data + buffer->length;
+            if(quote){
+                out = write_escaped(out, bytes, length, quote);
+            } else {
+                memcpy(out, bytes, length);
+                out += length;
+            }
+            *out++ = col + 1 < frame->column_count ? format->delimiter : '\n';
+            buffer->length = out - buffer->data;
+        }
+
+        if(fd >= 0 && buffer->length >= EXPORT_BUFFER_SIZE && buffer_flush(buffer, fd) != 0){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int format_header(const TextFormat *format, OutBuffer *buffer)
+{
+    const DataFrame *frame = format->frame;
+    for(size_t col = 0; col < frame->column_count; col++){
+        int quote;
+        const char *name = frame->columns[col].name;
+        size_t length = escaped_length(name, format->delimiter, frame->column_count == 1, &quote);
+        if(buffer_reserve(buffer, length + 1) != 0){
+            return -1;
+        }
+        char *out = write_escaped(buffer->data + buffer->length, name, length, quote);
+        *out++ = col + 1 < frame->column_count ? format->delimiter : '\n';
+        buffer->length = out - buffer->data;
+    }
+    return 0;
+}
+
+
+typedef struct {
+    const TextFormat *format;
+    size_t begin;
+    size_t end;
+    OutBuffer buffer;
+    int result;
+} FormatTask;
+
+static void *format_task(void *arg)
+{
+    FormatTask *task = arg;
+    task->buffer.length = 0;
+    task->result = format_rows(task->format, task->begin, task->end, &task->buffer, -1);
+    return NULL;
+}
+
+// threads format consecutive blocks of EXPORT_ROWS_PER_TASK rows, then the blocks are written out in order
+// before the next wave starts, so memory stays at about threads * block size
+static int export_text_parallel(const TextFormat *format, int fd, int threads)
+{
+    FormatTask *tasks = calloc(threads, sizeof(FormatTask));
+    pthread_t *handles = malloc(threads * sizeof(pthread_t));
+    int *started = malloc(threads * sizeof(int));
+    if(tasks == NULL || handles == NULL || started == NULL){
+        perror("Error allocating memory for export threads");
+        free(tasks);
+        free(handles);
+        free(started);
+        return -1;
+    }
+
+    int result = 0;
+    size_t rows = format->frame->row_count;
+    size_t next_row = 0;
+    while(result == 0 && next_row < rows){
+        int wave = 0;
+        for(; wave < threads && next_row < rows; wave++){
+            FormatTask *task = &tasks[wave];
+            task->format = format;
+            task->begin = next_row;
+            task->end = rows - next_row > EXPORT_ROWS_PER_TASK ? next_row + EXPORT_ROWS_PER_TASK : rows;
+            next_row = task->end;
+            // if we can't get a thread, just do the work here
+            started[wave] = pthread_create(&handles[wave], NULL, format_task, task) == 0;
+            if(!started[wave]){
+                format_task(task);
+            }
+        }
+
+        for(int i = 0; i < wave; i++){
+            if(started[i]){
+                pthread_join(handles[i], NULL);
+            }
+        }
+        for(int i = 0; i < wave && result == 0; i++){
+            if(tasks[i].result != 0 || buffer_flush(&tasks[i].buffer, fd) != 0){
+                result = -1;
+            }
+        }
+    }
+
+    for(int i = 0; i < threads; i++){
+        free(tasks[i].buffer.data);
+    }
+    free(tasks);
+    free(handles);
+    free(started);
+    return result;
+}
+
+static int export_text(const DataFrame *frame, int fd, const ExportOptions *options, char delimiter)
+{
+    TextFormat format;
+    if(text_format_init(&format, frame, delimiter) != 0){
+        return -1;
+    }
+
+    OutBuffer buffer = { 0 };
+    int result = 0;
+    if(options->header && format_header(&format, &buffer) != 0){
+        result = -1;
+    }
+
+    if(result == 0 && options->threads > 1 && frame->row_count > EXPORT_ROWS_PER_TASK){
+        if(buffer_flush(&buffer, fd) != 0 || export_text_parallel(&format, fd, options->threads) != 0){
+            result = -1;
+        }
+    } else if(result == 0){
+        if(format_rows(&format, 0, frame->row_count, &buffer, fd) != 0 || buffer_flush(&buffer, fd) != 0){
+            result = -1;
+        }
+    }
+
+    free(buffer.data);
+    text_format_free(&format);
+    return result;
+}
+
+
+static int append_u8(OutBuffer *buffer, uint8_t value)
+{
+    return buffer_append(buffer, &value, sizeof(value));
+}
+
+static int append_u32(OutBuffer *buffer, uint32_t value)
+{
+    return buffer_append(buffer, &value, sizeof(value));
+}
+
+static int append_u64(OutBuffer *buffer, uint64_t value)
+{
+    return buffer_append(buffer, &value, sizeof(value));
+}
+
+// the buffer is flushed between values, so only the string being appended has to fit in memory twice
+static int append_string_flushing(OutBuffer *buffer, int fd, const char *value, size_t length)
+{
+    if(buffer_append(buffer, value, length) != 0){
+        return -1;
+    }
+    if(buffer->length >= EXPORT_BUFFER_SIZE){
+        return buffer_flush(buffer, fd);
+    }
+    return 0;
+}
+
+static int export_binary_column(const Column *column, size_t row_count, OutBuffer *buffer, int fd)
+{
+    size_t name_length = strlen(column->name);
+    if(append_u32(buffer, (uint32_t)name_length) != 0
+        || buffer_append(buffer, column->name, name_length) != 0
+        || append_u8(buffer, column->encoding == COLUMN_DICT ? 0 : 1) != 0
+        || append_u8(buffer, column->code_width) != 0)
+    {
+        return -1;
+    }
+
+    if(column->encoding == COLUMN_DICT){
+        if(append_u32(buffer, column->dict.count) != 0){
+            return -1;
+        }
+        for(uint32_t code = 0; code < column->dict.count; code++){
+            const char *value = column->dict.values[code];
+            size_t length = strlen(value);
+            if(append_u32(buffer, (uint32_t)length) != 0
+                || append_string_flushing(buffer, fd, value, length) != 0)
+            {
+                return -1;
+            }
+        }
+        // the codes are already laid out the way we want them, write them straight from the column
+        if(buffer_flush(buffer, fd) != 0){
+            return -1;
+        }
+        return write_all(fd, column->codes, row_count * column->code_width);
+    }
+
+    uint64_t offset = 0;
+    if(append_u64(buffer, offset) != 0){
+        return -1;
+    }
+    for(size_t row = 0; row < row_count; row++){
+        offset += strlen(column->values[row]);
+        if(append_u64(buffer, offset) != 0){
+            return -1;
+        }
+        if(buffer->length >= EXPORT_BUFFER_SIZE && buffer_flush(buffer, fd) != 0){
+            return -1;
+        }
+    }
+    for(size_t row = 0; row < row_count; row++){
+        const char *value = column->values[row];
+        if(append_string_flushing(buffer, fd, value, strlen(value)) != 0){
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int export_binary(const DataFrame *frame, int fd)
+{
+    OutBuffer buffer = { 0 };
+    int result = 0;
+    if(buffer_append(&buffer, EXPORT_BINARY_MAGIC, strlen(EXPORT_BINARY_MAGIC)) != 0
+        || append_u64(&buffer, frame->row_count) != 0
+        || append_u64(&buffer, frame->column_count) != 0)
+    {
+        result = -1;
+    }
+    for(size_t col = 0; result == 0 && col < frame->column_count; col++){
+        result = export_binary_column(&frame->columns[col], frame->row_count, &buffer, fd);
+    }
+    if(result == 0){
+        result = buffer_flush(&buffer, fd);
+    }
+    free(buffer.data);
+    return result;
+}
+
+
+int dataframe_export(const DataFrame *frame, int fd, const ExportOptions *options)
+{
+    switch(options->format){
+        case EXPORT_CSV: return export_text(frame, fd, options, ',');
+        case EXPORT_TSV: return export_text(frame, fd, options, '\t');
+        case EXPORT_BINARY: return export_binary(frame, fd);
+    }
+    fprintf(stderr, "Error: Unknown Export Format %d\n", (int)options->format);
+    return -1;
+}
+
+int dataframe_export_file(const DataFrame *frame, const char *filename, const ExportOptions *options)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        perror("Error Opening Export File");
+        return -1;
+    }
+    int result = dataframe_export(frame, fd, options);
+    if(close(fd) != 0){
+        perror("Error Closing Export File");
+        result = -1;
+    }
+    return result;
+}
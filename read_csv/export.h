@@ -0,0 +1,32 @@
+#ifndef READ_CSV_EXPORT_H
+#define READ_CSV_EXPORT_H
+
+#include "dataframe.h"
+
+#define EXPORT_BUFFER_SIZE (1 << 20)   // flush formatted output in 1MB writes
+#define EXPORT_ROWS_PER_TASK 16384     // rows each thread formats per task in parallel mode
+#define EXPORT_BINARY_MAGIC "MFRAME01"
+
+typedef enum {
+    EXPORT_CSV,
+    EXPORT_TSV,
+    EXPORT_BINARY
+} ExportFormat;
+
+typedef struct {
+    ExportFormat format;
+    int header;   // write the column names first (csv / tsv only)
+    int threads;  // > 1 formats disjoint row ranges in parallel (csv / tsv only)
+} ExportOptions;
+
+// csv / tsv: fields containing the delimiter, a quote, \r or \n are quoted, with quotes doubled
+//
+// binary is a raw column dump in native byte order:
+//   magic "MFRAME01", uint64 row_count, uint64 column_count
+//   per column: uint32 name_length, name bytes, uint8 encoding (0 dict, 1 plain), uint8 code_width
+//     dict:  uint32 dict_count, per value (uint32 length, bytes), then row_count * code_width bytes of codes
+//     plain: uint64 offsets[row_count + 1] into the data that follows, then the concatenated values
+int dataframe_export(const DataFrame *frame, int fd, const ExportOptions *options);
+int dataframe_export_file(const DataFrame *frame, const char *filename, const ExportOptions *options);
+
+#endif